@@ -0,0 +1,89 @@
+//
+// Licensed under Apache 2.0 license.
+// See accompanying LICENSE file for details.
+//
+
+// This example shows a second task manager, with its own
+// tasks, added to the global task manager with a reservation
+// that limits how much time its tasks can take.
+// Please use the serial monitor to see its activity.
+
+#include <DebugMsgs.h>  // https://github.com/markwomack/ArduinoLogging
+
+#include "TaskManager.h"
+#include "Task.h"
+#include "BlinkTask.h"
+#include "TaskManagerTask.h"
+
+// This task stands in for a slow module, it takes about
+// 5 milliseconds every time it is executed.
+class SlowTask : public Task {
+  public:
+    void update(void) {
+      delay(5);
+    };
+};
+SlowTask slowTask1;
+SlowTask slowTask2;
+
+// This task prints out how many times it was executed
+// every second, and the most time used by the slow tasks
+// in a single replenish period.
+class ReportTask : public Task {
+  public:
+    void setReservedTaskIdentifier(int8_t reservedTaskIdentifier) {
+      _reservedTaskIdentifier = reservedTaskIdentifier;
+    };
+
+    void start(void) {
+      _counter = 0;
+    };
+
+    void update(void) {
+      _counter++;
+      if (_counter % 100 == 0) {
+        DebugMsgs.debug().print("Report executions: ").print(_counter)
+          .print(", slow tasks max usage: ")
+          .println(taskManager.getReservedTaskMaxUsage(_reservedTaskIdentifier));
+      }
+    };
+
+  private:
+    int8_t _reservedTaskIdentifier;
+    unsigned long _counter;
+};
+ReportTask reportTask;
+
+// This is the task manager for the slow tasks, and
+// the task that runs it in the global task manager
+TaskManager slowTaskManager;
+TaskManagerTask slowTaskManagerTask(slowTaskManager);
+
+void setup() {
+  Serial.begin(9600);
+
+  // This will allow the printing of debug messages
+  DebugMsgs.enableLevel(DEBUG);
+
+  // Add the slow tasks to their own task manager, always executing
+  slowTaskManager.addTask(&slowTask1, 0);
+  slowTaskManager.addTask(&slowTask2, 0);
+
+  // Add the slow task manager to the global task manager. Its tasks can
+  // only use 10 milliseconds every 50 milliseconds, about 20% of the time.
+  int8_t reservedTaskIdentifier = taskManager.addReservedTask(&slowTaskManagerTask, 0, 10000, 50);
+  reportTask.setReservedTaskIdentifier(reservedTaskIdentifier);
+
+  // Add the report task to execute every 10 milliseconds, and
+  // a blink task to blink every half second
+  taskManager.addTask(&reportTask, 10);
+  taskManager.addBlinkTask(500);
+
+  // Start the task manager
+  taskManager.start();
+}
+
+void loop() {
+  // Run the task manager
+  taskManager.update();
+}
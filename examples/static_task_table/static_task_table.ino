@@ -0,0 +1,62 @@
+//
+// Licensed under Apache 2.0 license.
+// See accompanying LICENSE file for details.
+//
+
+// This example shows a fixed set of tasks declared at compile
+// time with a StaticTaskTable, instead of being added to the
+// task manager in setup().
+// Please use the serial monitor to see its activity.
+
+#include <DebugMsgs.h>  // https://github.com/markwomack/ArduinoLogging
+
+#include "StaticTaskTable.h"
+
+unsigned long counter;
+int ledState;
+
+// Toggles the builtin LED
+void blink(void) {
+  ledState = !ledState;
+  digitalWrite(LED_BUILTIN, ledState);
+}
+
+// Increments the counter
+void count(void) {
+  counter++;
+}
+
+// Prints out the current value of the counter
+void printCounter(void) {
+  DebugMsgs.debug().print("Counter: ").println(counter);
+}
+
+// The table of tasks. The counter is incremented every 100
+// milliseconds, and has the highest priority. The counter is
+// printed every second, starting 50 milliseconds after the
+// counter. The LED blinks every half second.
+StaticTaskTable<
+  StaticTask<count, 100, 0, 1>,
+  StaticTask<printCounter, 1000, 50>,
+  StaticTask<blink, 500>
+> staticTasks;
+
+void setup() {
+  Serial.begin(9600);
+
+  // This will allow the printing of debug messages
+  DebugMsgs.enableLevel(DEBUG);
+
+  pinMode(LED_BUILTIN, OUTPUT);
+  ledState = LOW;
+  digitalWrite(LED_BUILTIN, ledState);
+  counter = 0;
+
+  // Start executing the tasks
+  staticTasks.start();
+}
+
+void loop() {
+  // Run the tasks
+  staticTasks.update();
+}
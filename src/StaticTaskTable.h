@@ -0,0 +1,158 @@
+//
+// Licensed under Apache 2.0 license.
+// See accompanying LICENSE file for details.
+//
+
+#ifndef STATICTASKTABLE_H
+#define STATICTASKTABLE_H
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+// This declares a single entry of a StaticTaskTable. The callable
+// is a plain function that is called every periodInMillis, with
+// its first call phaseInMillis after the table is started. When
+// more than one task is due, the one with the highest priority
+// is called first. Tasks with the same priority take turns: the
+// table is searched in declaration order starting after the last
+// task called, so one that is always due cannot keep the others
+// from being called.
+//
+// All of the values are template arguments, so they are compiled
+// into the code in flash (no PROGMEM tables need to be read) and
+// the callable can be inlined by the compiler.
+//
+template<void (*CALLABLE)(void), uint32_t PERIOD_IN_MILLIS,
+    uint32_t PHASE_IN_MILLIS = 0, uint8_t PRIORITY = 0>
+struct StaticTask {
+  static void call(void) {
+    CALLABLE();
+  };
+
+  static constexpr uint32_t periodInMillis = PERIOD_IN_MILLIS;
+  static constexpr uint32_t phaseInMillis = PHASE_IN_MILLIS;
+  static constexpr uint8_t priority = PRIORITY;
+};
+
+// This is used by the StaticTaskTable to generate the code for each
+// of its tasks. The recursion is resolved at compile time, so the
+// generated code is an unrolled sequence of checks and calls.
+//
+template<uint8_t INDEX, typename... Tasks>
+struct StaticTaskDispatcher {
+  static void start(uint32_t*, uint32_t) {};
+
+  static int8_t findNextTask(const uint32_t*, uint32_t, uint8_t, int8_t nextTask, uint8_t) {
+    return nextTask;
+  };
+
+  static void executeTask(uint32_t*, int8_t) {};
+};
+
+template<uint8_t INDEX, typename FirstTask, typename... OtherTasks>
+struct StaticTaskDispatcher<INDEX, FirstTask, OtherTasks...> {
+  typedef StaticTaskDispatcher<INDEX + 1, OtherTasks...> Next;
+
+  // Set the time of the first execution of each task
+  static void start(uint32_t* nextExecutionTimes, uint32_t currentMillis) {
+    nextExecutionTimes[INDEX] = currentMillis + FirstTask::phaseInMillis;
+    Next::start(nextExecutionTimes, currentMillis);
+  };
+
+  // Return the index of the due task with the highest priority, or -1.
+  // Of the due tasks with the same priority, return the first one at or
+  // after startIndex, wrapping around to the start of the table.
+  static int8_t findNextTask(const uint32_t* nextExecutionTimes, uint32_t currentMillis,
+      uint8_t startIndex, int8_t nextTask, uint8_t nextTaskPriority) {
+    if ((int32_t)(currentMillis - nextExecutionTimes[INDEX]) >= 0
+        && (nextTask == -1 || FirstTask::priority > nextTaskPriority
+          || (FirstTask::priority == nextTaskPriority && nextTask < startIndex && INDEX >= startIndex))) {
+      nextTask = INDEX;
+      nextTaskPriority = FirstTask::priority;
+    }
+    return Next::findNextTask(nextExecutionTimes, currentMillis, startIndex, nextTask, nextTaskPriority);
+  };
+
+  // Call the task at index and record the time of its next execution
+  static void executeTask(uint32_t* nextExecutionTimes, int8_t index) {
+    if (index == INDEX) {
+      FirstTask::call();
+      nextExecutionTimes[INDEX] = millis() + FirstTask::periodInMillis;
+    } else {
+      Next::executeTask(nextExecutionTimes, index);
+    }
+  };
+};
+
+// This class executes a fixed set of tasks that is declared at compile
+// time, as an alternative to adding tasks to the TaskManager at runtime.
+// The only RAM it uses is the time of the next execution of each task,
+// and each task is called directly, without a virtual Task method. For
+// example:
+//
+//   StaticTaskTable<
+//     StaticTask<readSensors, 10>,
+//     StaticTask<updateMotors, 20, 5, 1>,
+//     StaticTask<sendTelemetry, 1000>
+//   > staticTasks;
+//
+// Like the TaskManager, it executes at most one task each time update()
+// is called. The TaskManager can still be used alongside it for tasks
+// that are added dynamically.
+//
+template<typename... Tasks>
+class StaticTaskTable {
+  static_assert(sizeof...(Tasks) > 0, "StaticTaskTable needs at least one task");
+  static_assert(sizeof...(Tasks) <= 127, "StaticTaskTable supports at most 127 tasks");
+
+  public:
+    StaticTaskTable() {
+      _isExecuting = false;
+      _nextIndex = 0;
+    };
+
+    // Starts executing the tasks. Each task will first be executed
+    // after its phaseInMillis, and then every periodInMillis.
+    void start(void) {
+      if (_isExecuting) {
+        return;
+      }
+      Dispatcher::start(_nextExecutionTimes, millis());
+      _nextIndex = 0;
+      _isExecuting = true;
+    };
+
+    // Executes the due task with the highest priority, rotating through
+    // the due tasks with the same priority. This method should be called
+    // periodically, typically in the Arduino loop() method.
+    void update(void) {
+      if (!_isExecuting) {
+        return;
+      }
+      int8_t index = Dispatcher::findNextTask(_nextExecutionTimes, millis(), _nextIndex, -1, 0);
+      if (index != -1) {
+        // The task after this one is checked first in the next call
+        _nextIndex = (index + 1) % sizeof...(Tasks);
+        Dispatcher::executeTask(_nextExecutionTimes, index);
+      }
+    };
+
+    // Stops executing the tasks.
+    void stop(void) {
+      _isExecuting = false;
+    };
+
+    // Returns true if the tasks are currently executing, false otherwise.
+    bool isExecuting(void) {
+      return _isExecuting;
+    };
+
+  private:
+    typedef StaticTaskDispatcher<0, Tasks...> Dispatcher;
+
+    uint32_t _nextExecutionTimes[sizeof...(Tasks)];
+    uint8_t _nextIndex;
+    bool _isExecuting;
+};
+
+#endif // STATICTASKTABLE_H
@@ -34,6 +34,10 @@
 //  has been reached. A periodInMillis value was given when
 //  the task was added, and the update() method will be called
 //  each time that time has elapsed.
+// periodChanged() - Called when the task manager changes the
+//  period of an elastic task because it is overloaded, or
+//  because the overload has passed. The update() method will
+//  be called every newPeriodInMillis from then on.
 //
 class Task {
   public:
@@ -67,6 +71,12 @@ class Task {
       // base version does nothing
     };
 
+    // Called when the task manager changes the period of
+    // an elastic task to adapt to the current load.
+    virtual void periodChanged(uint32_t /* newPeriodInMillis */) {
+      // base version does nothing
+    };
+
     String getTaskName(void) {
       return _taskName;
     };
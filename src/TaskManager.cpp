@@ -16,9 +16,21 @@ TaskManager::TaskManager() {
   for (int x = 0; x < MAX_IDLE_TASKS; x++) {
     emptyTaskEvent(&_idleTaskEvents[x]);
   }
+  for (int x = 0; x < MAX_BACKGROUND_TASKS; x++) {
+    emptyBackgroundTaskEvent(&_backgroundTaskEvents[x]);
+  }
+  for (int x = 0; x < MAX_RESERVED_TASKS; x++) {
+    emptyTaskReservation(&_taskReservations[x]);
+  }
   
   _isExecuting = false;
   _nextIndex = 0;
+  _nextBackgroundIndex = 0;
+  _backgroundTaskCount = 0;
+  
+  _utilizationPercent = 0;
+  _isOverloaded = false;
+  resetLoadWindow();
 }
 
 int8_t TaskManager::addTask(Task* task, uint32_t periodInMillis) {
@@ -59,6 +71,69 @@ int8_t TaskManager::addBlinkTask(uint32_t periodInMillis) {
   return addTask(&_builtinBlinkTask, periodInMillis);
 }
 
+int8_t TaskManager::addElasticTask(Task* task, uint32_t minPeriodInMillis, uint32_t maxPeriodInMillis) {
+  // A period of 0 cannot be stretched, and the bounds must be in order
+  if (minPeriodInMillis == 0 || minPeriodInMillis > maxPeriodInMillis) {
+    return -1;
+  }
+  
+  // Add the task at its shortest period
+  int8_t index = addTask(task, minPeriodInMillis);
+  if (index == -1) {
+    return -1;
+  }
+  
+  // Record the bounds the period can be changed within
+  _taskEvents[index].minPeriodInMillis = minPeriodInMillis;
+  _taskEvents[index].maxPeriodInMillis = maxPeriodInMillis;
+  
+  return index;
+}
+
+int8_t TaskManager::addReservedTask(Task* task, uint32_t periodInMillis, uint32_t budgetInMicros,
+    uint32_t replenishPeriodInMillis) {
+  // A budget of 0 would never execute the task, and a replenish period
+  // of 0 would never limit it. The budget must fit the signed remaining
+  // budget.
+  if (budgetInMicros == 0 || budgetInMicros > INT32_MAX || replenishPeriodInMillis == 0) {
+    return -1;
+  }
+  
+  // Find the next free spot in the taskReservations array
+  int reservationIndex = findFreeReservationSlot();
+  if (reservationIndex == -1) {
+    return -1;
+  }
+  
+  int8_t index = addTask(task, periodInMillis);
+  if (index == -1) {
+    return -1;
+  }
+  
+  // Initialize the taskReservation with a full budget
+  _taskReservations[reservationIndex].taskIdentifier = index;
+  _taskReservations[reservationIndex].budgetInMicros = budgetInMicros;
+  _taskReservations[reservationIndex].replenishPeriodInMillis = replenishPeriodInMillis;
+  _taskReservations[reservationIndex].remainingBudgetInMicros = budgetInMicros;
+  _taskReservations[reservationIndex].lastReplenishTime = millis();
+  _taskEvents[index].reservationIndex = reservationIndex;
+  
+  return index;
+}
+
+uint32_t TaskManager::getReservedTaskMaxUsage(int8_t taskIdentifier) {
+  for (int8_t x = 0; x < MAX_RESERVED_TASKS; x++) {
+    if (_taskReservations[x].taskIdentifier == taskIdentifier) {
+      // Include the usage in the current replenish period
+      if (_taskReservations[x].usedInMicros > _taskReservations[x].maxUsedInMicros) {
+        return _taskReservations[x].usedInMicros;
+      }
+      return _taskReservations[x].maxUsedInMicros;
+    }
+  }
+  return 0;
+}
+
 int8_t TaskManager::addIdleTask(Task* task, uint32_t periodInMillis) {
 
   // Find the next free spot in the idleTaskEvents array
@@ -98,6 +173,35 @@ int8_t TaskManager::addIdleBlinkTask(uint32_t periodInMillis) {
   return addIdleTask(&_builtinIdleBlinkTask, periodInMillis);
 }
 
+int8_t TaskManager::addBackgroundTask(Task* task, uint32_t periodInMillis, uint32_t costInMicros) {
+  // Find the next free spot in the backgroundTaskEvents array
+  int index = findFreeBackgroundSlot();
+  if (index == -1) {
+    return -1;
+  }
+
+  // Initialize the backgroundTaskEvent, if no cost was given
+  // it will be measured when the task is executed
+  _backgroundTaskEvents[index].taskEvent.status = ACTIVE;
+  _backgroundTaskEvents[index].taskEvent.task = task;
+  _backgroundTaskEvents[index].taskEvent.periodInMillis = periodInMillis;
+  _backgroundTaskEvents[index].costInMicros = costInMicros;
+  _backgroundTaskEvents[index].isCostMeasured = (costInMicros == 0);
+  _backgroundTaskCount++;
+  
+  // Call the task setup method
+  task->setup();
+  
+  // If the task manager is currently executing, call the
+  // start method of the task
+  if (_isExecuting) {
+    startTask(&_backgroundTaskEvents[index].taskEvent);
+  }
+    
+  // Return the index as the task identifier
+  return index;
+}
+
 int8_t TaskManager::changeTaskPeriod(int8_t taskIdentifier, uint32_t newPeriodInMillis) {
   // If the taskIdentifier is valid, update the periodInMillis value
   if (_taskEvents[taskIdentifier].status == ACTIVE) {
@@ -117,6 +221,12 @@ int8_t TaskManager::removeTask(int8_t taskIdentifier) {
     if (_isExecuting) {
       _taskEvents[taskIdentifier].task->stop();
     }
+    
+    // Remove the reservation of the task, if it has one
+    TaskReservation* taskReservation = findTaskReservation(&_taskEvents[taskIdentifier]);
+    if (taskReservation != NULL) {
+      emptyTaskReservation(taskReservation);
+    }
     emptyTaskEvent(&_taskEvents[taskIdentifier]);
     return 0;
   }
@@ -141,6 +251,23 @@ int8_t TaskManager::removeIdleTask(int8_t taskIdentifier) {
   return -1;
 }
 
+int8_t TaskManager::removeBackgroundTask(int8_t taskIdentifier) {
+  // If the taskIdentifier is valid, call the stop method of the task
+  // if the task manager is running, and empty the element of the
+  // _backgroundTaskEvents array
+  if (_backgroundTaskEvents[taskIdentifier].taskEvent.status == ACTIVE) {
+    if (_isExecuting) {
+      _backgroundTaskEvents[taskIdentifier].taskEvent.task->stop();
+    }
+    emptyBackgroundTaskEvent(&_backgroundTaskEvents[taskIdentifier]);
+    _backgroundTaskCount--;
+    return 0;
+  }
+  
+  // Return -1 if the taskIdentifier is invalid
+  return -1;
+}
+
 void TaskManager::removeAllTasks(void) {
   for (int x = 0; x < MAX_TASKS; x++) {
     // if the task manager is currently executing, then call the stop method
@@ -152,12 +279,34 @@ void TaskManager::removeAllTasks(void) {
     // empty out the _taskEvents element
     emptyTaskEvent(&_taskEvents[x]);
   } 
+  for (int x = 0; x < MAX_BACKGROUND_TASKS; x++) {
+    // if the task manager is currently executing, then call the stop method
+    // of any registered background task
+    if (_isExecuting && _backgroundTaskEvents[x].taskEvent.status == ACTIVE) {
+      _backgroundTaskEvents[x].taskEvent.task->stop();
+    }
+    
+    // empty out the _backgroundTaskEvents element
+    emptyBackgroundTaskEvent(&_backgroundTaskEvents[x]);
+  }
+  _backgroundTaskCount = 0;
+  for (int x = 0; x < MAX_RESERVED_TASKS; x++) {
+    emptyTaskReservation(&_taskReservations[x]);
+  }
 }
 
 bool TaskManager::isExecuting(void) {
   return _isExecuting;
 }
 
+uint8_t TaskManager::getUtilization(void) {
+  return _utilizationPercent;
+}
+
+bool TaskManager::isOverloaded(void) {
+  return _isOverloaded;
+}
+
 void TaskManager::start(void) {
   // If already executing, exit early
   if (_isExecuting) {
@@ -171,9 +320,23 @@ void TaskManager::start(void) {
   
   // call the start method of all registered tasks
   startAllTasks();
+  startAllBackgroundTasks();
   
   // set the first index to be checked for execution in update() call.
   _nextIndex = 0;
+  _nextBackgroundIndex = 0;
+  
+  // start measuring the load from now, forgetting the last run
+  _utilizationPercent = 0;
+  _isOverloaded = false;
+  resetLoadWindow();
+  
+  // start every reserved task with a full budget
+  for (int8_t x = 0; x < MAX_RESERVED_TASKS; x++) {
+    _taskReservations[x].remainingBudgetInMicros = _taskReservations[x].budgetInMicros;
+    _taskReservations[x].lastReplenishTime = millis();
+    _taskReservations[x].usedInMicros = 0;
+  }
   
   // task manager is now executing
   _isExecuting = true;
@@ -211,6 +374,13 @@ void TaskManager::update(void) {
   
   // Executing, execute next task
   _nextIndex = executeNextTask(_nextIndex, _taskEvents, MAX_TASKS);
+  
+  // Adapt the elastic tasks to the current load
+  checkLoad();
+  
+  // Use any slack time before the next task is due to execute
+  // the next background task
+  executeNextBackgroundTask();
 }
 
 /**
@@ -225,6 +395,7 @@ void TaskManager::stop(void) {
   DebugMsgs.debug().println("*** Stopping execution");
 
   stopAllTasks();
+  stopAllBackgroundTasks();
   
   // stop execution
   _isExecuting = false;
@@ -260,6 +431,12 @@ void TaskManager::startAllIdleTasks() {
   }
 }
 
+void TaskManager::startAllBackgroundTasks() {
+  for (int8_t x = 0; x < MAX_BACKGROUND_TASKS; x++) {
+    startTask(&_backgroundTaskEvents[x].taskEvent);
+  }
+}
+
 void TaskManager::stopAllTasks() {
   // call the stop method of all the registered tasks
   for (int8_t x = 0; x < MAX_TASKS; x++) {
@@ -278,6 +455,15 @@ void TaskManager::stopAllIdleTasks() {
   }
 }
 
+void TaskManager::stopAllBackgroundTasks() {
+  // call the stop method of all the registered background tasks
+  for (int8_t x = 0; x < MAX_BACKGROUND_TASKS; x++) {
+    if (_backgroundTaskEvents[x].taskEvent.status == ACTIVE) {
+      _backgroundTaskEvents[x].taskEvent.task->stop();
+    }      
+  }
+}
+
 uint8_t TaskManager::executeNextTask(uint8_t nextTaskIndex, TaskEvent* taskEvents, uint8_t taskEventsSize) {
   uint8_t index = nextTaskIndex;
   bool executed = false;
@@ -306,11 +492,39 @@ uint8_t TaskManager::executeNextTask(uint8_t nextTaskIndex, TaskEvent* taskEvent
 bool TaskManager::executeTask(TaskEvent* taskEvent) {
   if (taskEvent->status == ACTIVE) {
     uint32_t currentMillis = millis();
-    if (currentMillis >= taskEvent->lastExecutionTime + taskEvent->periodInMillis) {
+    uint32_t nextExecutionTime = taskEvent->lastExecutionTime + taskEvent->periodInMillis;
+    if (currentMillis >= nextExecutionTime) {
+      // A reserved task is not executed until its budget is replenished
+      TaskReservation* taskReservation = findTaskReservation(taskEvent);
+      if (taskReservation != NULL && !replenishTaskReservation(taskReservation)) {
+        return false;
+      }
+      
+      uint32_t startMicros = micros();
       taskEvent->task->update();
+      uint32_t elapsedMicros = micros() - startMicros;
+      
+      // Record how long the task took and how late it was for the load window.
+      // Tasks with a period of 0 are always due and fill any free time, so
+      // they are not counted. Reserved tasks are late by design when their
+      // budget is used up, so their lateness is not counted.
+      if (taskEvent->periodInMillis > 0) {
+        _windowBusyMicros += elapsedMicros;
+        if (taskReservation == NULL) {
+          _windowLatenessMillis += currentMillis - nextExecutionTime;
+          _windowExecutions++;
+        }
+      }
+      
       // Make sure this task event is still active (the update could have removed it)
       if (taskEvent->status == ACTIVE) {
         taskEvent->lastExecutionTime = millis();
+        
+        // Charge the execution time to the budget of a reserved task
+        if (taskReservation != NULL) {
+          taskReservation->remainingBudgetInMicros -= elapsedMicros;
+          taskReservation->usedInMicros += elapsedMicros;
+        }
       }
       return true;
     }
@@ -318,6 +532,216 @@ bool TaskManager::executeTask(TaskEvent* taskEvent) {
   return false;
 }
 
+// Return the reservation of the taskEvent, or NULL if it does not
+// have one.
+TaskManager::TaskReservation* TaskManager::findTaskReservation(TaskEvent* taskEvent) {
+  if (taskEvent->reservationIndex == -1) {
+    return NULL;
+  }
+  return &_taskReservations[taskEvent->reservationIndex];
+}
+
+// If the replenish period has elapsed, add the budget back to the
+// taskReservation, first paying back any overrun, and record the most
+// used in a single period. Return true if there is budget remaining,
+// false if not.
+bool TaskManager::replenishTaskReservation(TaskReservation* taskReservation) {
+  uint32_t currentMillis = millis();
+  if (currentMillis >= taskReservation->lastReplenishTime + taskReservation->replenishPeriodInMillis) {
+    if (taskReservation->usedInMicros > taskReservation->maxUsedInMicros) {
+      taskReservation->maxUsedInMicros = taskReservation->usedInMicros;
+    }
+    taskReservation->usedInMicros = 0;
+    
+    taskReservation->remainingBudgetInMicros += taskReservation->budgetInMicros;
+    if (taskReservation->remainingBudgetInMicros > (int32_t)taskReservation->budgetInMicros) {
+      taskReservation->remainingBudgetInMicros = taskReservation->budgetInMicros;
+    }
+    taskReservation->lastReplenishTime = currentMillis;
+  }
+  return taskReservation->remainingBudgetInMicros > 0;
+}
+
+// Start a new window for measuring the load.
+void TaskManager::resetLoadWindow(void) {
+  _windowStartTime = millis();
+  _windowBusyMicros = 0;
+  _windowLatenessMillis = 0;
+  _windowExecutions = 0;
+  _overloadedWindows = 0;
+  _underloadedWindows = 0;
+}
+
+// At the end of each window, calculate the utilization and the average
+// lateness of the executed tasks. Stretch the periods of the elastic
+// tasks when overloaded for OVERLOAD_WINDOWS consecutive windows, and
+// restore them when underloaded for as many windows.
+void TaskManager::checkLoad(void) {
+  uint32_t elapsedMillis = millis() - _windowStartTime;
+  if (elapsedMillis < OVERLOAD_WINDOW_MILLIS) {
+    return;
+  }
+  
+  uint32_t utilization = _windowBusyMicros / (elapsedMillis * 10);
+  _utilizationPercent = (utilization > 100) ? 100 : utilization;
+  uint32_t averageLatenessMillis =
+    (_windowExecutions > 0) ? _windowLatenessMillis / _windowExecutions : 0;
+  
+  _isOverloaded = _utilizationPercent >= OVERLOAD_UTILIZATION_PERCENT
+    || averageLatenessMillis >= OVERLOAD_LATENESS_MILLIS;
+  bool isUnderloaded = !_isOverloaded && _utilizationPercent <= UNDERLOAD_UTILIZATION_PERCENT;
+  
+  // Count the consecutive windows, keeping the counts across the reset
+  uint8_t overloadedWindows = _isOverloaded ? _overloadedWindows + 1 : 0;
+  uint8_t underloadedWindows = isUnderloaded ? _underloadedWindows + 1 : 0;
+  resetLoadWindow();
+  
+  if (overloadedWindows >= OVERLOAD_WINDOWS) {
+    DebugMsgs.debug().print("*** Overloaded, utilization: ").println(_utilizationPercent);
+    changeElasticTaskPeriods(true);
+    overloadedWindows = 0;
+  } else if (underloadedWindows >= OVERLOAD_WINDOWS) {
+    changeElasticTaskPeriods(false);
+    underloadedWindows = 0;
+  }
+  
+  _overloadedWindows = overloadedWindows;
+  _underloadedWindows = underloadedWindows;
+}
+
+// Double (stretch) or halve (restore) the period of every elastic task,
+// keeping it within its bounds, and notify the tasks that changed.
+void TaskManager::changeElasticTaskPeriods(bool stretch) {
+  for (int8_t x = 0; x < MAX_TASKS; x++) {
+    TaskEvent* taskEvent = &_taskEvents[x];
+    if (taskEvent->status != ACTIVE || taskEvent->maxPeriodInMillis == 0) {
+      continue;
+    }
+    
+    uint32_t newPeriodInMillis;
+    if (stretch) {
+      newPeriodInMillis = (taskEvent->periodInMillis > taskEvent->maxPeriodInMillis / 2)
+        ? taskEvent->maxPeriodInMillis : taskEvent->periodInMillis * 2;
+    } else {
+      newPeriodInMillis = (taskEvent->periodInMillis / 2 < taskEvent->minPeriodInMillis)
+        ? taskEvent->minPeriodInMillis : taskEvent->periodInMillis / 2;
+    }
+    
+    if (newPeriodInMillis != taskEvent->periodInMillis) {
+      taskEvent->periodInMillis = newPeriodInMillis;
+      taskEvent->task->periodChanged(newPeriodInMillis);
+    }
+  }
+}
+
+// Return the time in microseconds until the next task is due. The
+// current millisecond is not counted since an unknown part of it has
+// already elapsed. Return 0 if a task is due now.
+uint32_t TaskManager::getSlackInMicros(void) {
+  uint32_t currentMillis = millis();
+  uint32_t slackInMillis = UINT32_MAX;
+  
+  for (int8_t x = 0; x < MAX_TASKS; x++) {
+    if (_taskEvents[x].status == ACTIVE) {
+      uint32_t nextExecutionTime = _taskEvents[x].lastExecutionTime + _taskEvents[x].periodInMillis;
+      
+      // A reserved task that has used up its budget is not due
+      // until the budget is replenished
+      TaskReservation* taskReservation = findTaskReservation(&_taskEvents[x]);
+      if (taskReservation != NULL && taskReservation->remainingBudgetInMicros <= 0) {
+        uint32_t replenishTime = taskReservation->lastReplenishTime + taskReservation->replenishPeriodInMillis;
+        if (replenishTime > nextExecutionTime) {
+          nextExecutionTime = replenishTime;
+        }
+      }
+      
+      if (currentMillis >= nextExecutionTime) {
+        return 0;
+      }
+      if (nextExecutionTime - currentMillis < slackInMillis) {
+        slackInMillis = nextExecutionTime - currentMillis;
+      }
+    }
+  }
+  
+  // Convert to microseconds, without overflowing
+  slackInMillis--;
+  if (slackInMillis >= UINT32_MAX / 1000) {
+    return UINT32_MAX;
+  }
+  return slackInMillis * 1000;
+}
+
+// Find the first background task that is due and fits in the slack
+// time, and execute it. Background tasks are checked in rotation so
+// that a single background task cannot starve the others.
+void TaskManager::executeNextBackgroundTask(void) {
+  // If there are no background tasks, skip finding the slack time
+  if (_backgroundTaskCount == 0) {
+    return;
+  }
+  
+  uint32_t slackInMicros = getSlackInMicros();
+  
+  // If a task is due, there is no slack to use
+  if (slackInMicros == 0) {
+    return;
+  }
+  
+  uint8_t index = _nextBackgroundIndex;
+  bool executed = false;
+  do {
+    executed = executeBackgroundTask(&_backgroundTaskEvents[index], slackInMicros);
+    index = (index + 1) % MAX_BACKGROUND_TASKS;
+  } while (!executed && index != _nextBackgroundIndex);
+  
+  // Start with the task after the executed one in the next call
+  _nextBackgroundIndex = index;
+}
+
+// If the backgroundTaskEvent is active, then execute the task if it
+// is time to execute the task and its cost fits in the slack time.
+// Record the lastExecution time and, if the cost is being measured,
+// update the measured cost. Return true if executed, false if not.
+bool TaskManager::executeBackgroundTask(BackgroundTaskEvent* backgroundTaskEvent, uint32_t slackInMicros) {
+  TaskEvent* taskEvent = &backgroundTaskEvent->taskEvent;
+  if (taskEvent->status != ACTIVE) {
+    return false;
+  }
+  
+  uint32_t currentMillis = millis();
+  if (currentMillis < taskEvent->lastExecutionTime + taskEvent->periodInMillis) {
+    return false;
+  }
+  
+  // If the task does not fit in the slack time, it is not executed
+  if (backgroundTaskEvent->costInMicros >= slackInMicros) {
+    return false;
+  }
+  
+  uint32_t startMicros = micros();
+  taskEvent->task->update();
+  uint32_t elapsedMicros = micros() - startMicros;
+  
+  // Make sure this task event is still active (the update could have removed it)
+  if (taskEvent->status == ACTIVE) {
+    taskEvent->lastExecutionTime = millis();
+    
+    // A measured cost starts at the first execution, and then moves a
+    // quarter of the way towards each following execution
+    if (backgroundTaskEvent->isCostMeasured) {
+      if (backgroundTaskEvent->costInMicros == 0) {
+        backgroundTaskEvent->costInMicros = elapsedMicros;
+      } else if (elapsedMicros > backgroundTaskEvent->costInMicros) {
+        backgroundTaskEvent->costInMicros += (elapsedMicros - backgroundTaskEvent->costInMicros) / 4;
+      } else {
+        backgroundTaskEvent->costInMicros -= (backgroundTaskEvent->costInMicros - elapsedMicros) / 4;
+      }
+    }
+  }
+  return true;
+}
+
 // Return the index of a free slot in the _taskEvents array or return -1.
 int8_t TaskManager::findFreeSlot(void) {
   for (int8_t x = 0; x < MAX_TASKS; x++) {
@@ -340,12 +764,55 @@ int8_t TaskManager::findFreeIdleSlot(void) {
   return -1;  
 }
 
+// Return the index of a free slot in the _backgroundTaskEvents array or return -1.
+int8_t TaskManager::findFreeBackgroundSlot(void) {
+  for (int8_t x = 0; x < MAX_BACKGROUND_TASKS; x++) {
+    if (_backgroundTaskEvents[x].taskEvent.status == EMPTY) {
+      return x;
+    }
+  }
+
+  return -1;  
+}
+
+// Return the index of a free slot in the _taskReservations array or return -1.
+int8_t TaskManager::findFreeReservationSlot(void) {
+  for (int8_t x = 0; x < MAX_RESERVED_TASKS; x++) {
+    if (_taskReservations[x].taskIdentifier == -1) {
+      return x;
+    }
+  }
+
+  return -1;  
+}
+
 // Sets a slot in the taskEvents array to EMPTY.
 void TaskManager::emptyTaskEvent(TaskEvent* taskEvent) {
     taskEvent->status = EMPTY;
     taskEvent->task = NULL;
     taskEvent->periodInMillis = 0;
     taskEvent->lastExecutionTime = 0;
+    taskEvent->minPeriodInMillis = 0;
+    taskEvent->maxPeriodInMillis = 0;
+    taskEvent->reservationIndex = -1;
+}
+
+// Sets a slot in the backgroundTaskEvents array to EMPTY.
+void TaskManager::emptyBackgroundTaskEvent(BackgroundTaskEvent* backgroundTaskEvent) {
+    emptyTaskEvent(&backgroundTaskEvent->taskEvent);
+    backgroundTaskEvent->costInMicros = 0;
+    backgroundTaskEvent->isCostMeasured = false;
+}
+
+// Sets a slot in the taskReservations array to empty.
+void TaskManager::emptyTaskReservation(TaskReservation* taskReservation) {
+    taskReservation->taskIdentifier = -1;
+    taskReservation->budgetInMicros = 0;
+    taskReservation->replenishPeriodInMillis = 0;
+    taskReservation->remainingBudgetInMicros = 0;
+    taskReservation->lastReplenishTime = 0;
+    taskReservation->usedInMicros = 0;
+    taskReservation->maxUsedInMicros = 0;
 }
 
 // Global instance of TaskManager
@@ -19,11 +19,41 @@ const uint8_t MAX_TASKS(10);
 // Maximum number of idle tasks allowed.
 const uint8_t MAX_IDLE_TASKS(3);
 
+// Maximum number of background tasks allowed.
+const uint8_t MAX_BACKGROUND_TASKS(3);
+
+// Maximum number of tasks with a reservation allowed.
+const uint8_t MAX_RESERVED_TASKS(3);
+
+// The length of the window over which the load is measured.
+const uint32_t OVERLOAD_WINDOW_MILLIS(1000);
+
+// Percent of the window spent executing tasks at or above which
+// the task manager is considered overloaded.
+const uint8_t OVERLOAD_UTILIZATION_PERCENT(90);
+
+// Percent of the window spent executing tasks at or below which
+// the task manager is considered underloaded.
+const uint8_t UNDERLOAD_UTILIZATION_PERCENT(60);
+
+// Average lateness of the executed tasks at or above which the
+// task manager is considered overloaded.
+const uint32_t OVERLOAD_LATENESS_MILLIS(10);
+
+// Number of consecutive overloaded (or underloaded) windows before
+// the periods of the elastic tasks are changed.
+const uint8_t OVERLOAD_WINDOWS(2);
+
 // This class is used to manage the task manager. Its simplest usage is
 // to add tasks to be executed, calling start(), and then calling
 // update() to execute the tasks. Please see the accompanying examples
 // to see working code of different types of usage.
 //
+// A task manager can be added to another task manager by wrapping it
+// in a TaskManagerTask. Its tasks are then started, updated, and stopped
+// along with the other task manager. Adding it with addReservedTask()
+// limits the time its tasks can take from the other task manager.
+//
 class TaskManager {
   public:
     TaskManager();
@@ -49,6 +79,36 @@ class TaskManager {
     // task could not be added.
     int8_t addBlinkTask(uint32_t periodInMillis = 1000);
   
+    // Add an elastic task that will execute every minPeriodInMillis. When the
+    // task manager is overloaded for a sustained time, the period of elastic
+    // tasks is doubled, up to maxPeriodInMillis, leaving more time for the other
+    // tasks. When the overload passes, the period is halved again, down to
+    // minPeriodInMillis. Every change is reported by calling the periodChanged()
+    // method of the task. For example, a telemetry task could be added with a
+    // period of 100 ms that can stretch to 1 second.
+    // Returns a task identifer for reference in other methods, or -1 if the
+    // task could not be added, or if minPeriodInMillis is 0 or greater than
+    // maxPeriodInMillis.
+    int8_t addElasticTask(Task* task, uint32_t minPeriodInMillis, uint32_t maxPeriodInMillis);
+  
+    // Add a task that will execute every periodInMillis, but that can only use
+    // budgetInMicros of execution time every replenishPeriodInMillis. Once the
+    // budget is used up, the task is not executed until the budget is replenished.
+    // A single update() can run over the remaining budget, and the overrun is
+    // taken from the next budget. For example, another task manager could be added,
+    // using a TaskManagerTask, with a period of 0 and a budget of 2 ms every 10 ms,
+    // so its tasks will never take more than about 20% of the time.
+    // Returns a task identifer for reference in other methods, or -1 if the
+    // task could not be added, or if budgetInMicros is 0 or greater than
+    // INT32_MAX, or if replenishPeriodInMillis is 0.
+    int8_t addReservedTask(Task* task, uint32_t periodInMillis, uint32_t budgetInMicros,
+      uint32_t replenishPeriodInMillis);
+  
+    // Returns the most execution time, in microseconds, that the reserved task
+    // referenced by taskIdentifier has used in a single replenish period, or 0
+    // if it is not a reserved task.
+    uint32_t getReservedTaskMaxUsage(int8_t taskIdentifier);
+  
     // Adds a task that will only be executed when the task manager is idle, and
     // the task will be executed every periodInMillis. For example, this method could
     // be used to add a BlinkTask that does a fast blink when the task manager is idle.
@@ -56,6 +116,20 @@ class TaskManager {
     int8_t addIdleBlinkTask(uint8_t ledPin, uint32_t periodInMillis);
     int8_t addIdleBlinkTask(uint32_t periodInMillis = 1000);
   
+    // Adds a task that will only be executed in the slack time while the task
+    // manager is executing, no more often than every periodInMillis (0 means
+    // whenever there is slack). A background task is only executed when no
+    // periodic task is due before the background task would finish, so it does
+    // not add latency to the periodic tasks. costInMicros is the worst case
+    // execution time of the task's update() method. If 0 is given, the cost is
+    // measured by the task manager, as a moving average of its executions. A task
+    // whose measured cost never fits in the slack time is not executed again. The
+    // cost is unknown before the first execution, so give a cost if that first
+    // execution must not delay a periodic task.
+    // For example, this method could be used to add tasks that flush logs,
+    // write to EEPROM, or refresh a display.
+    int8_t addBackgroundTask(Task* task, uint32_t periodInMillis = 0, uint32_t costInMicros = 0);
+  
     // Changes the period of task referenced by taskIdentifier, and the task will
     // execute every newPeriodInMillis.
     int8_t changeTaskPeriod(int8_t taskIdentifier, uint32_t newPeriodInMillis);
@@ -71,14 +145,27 @@ class TaskManager {
     // when the task was added, this method will not free that memory. It is the
     // responsibility of the original creator to clean up memory.
     int8_t removeIdleTask(int8_t taskIdentifier);
+  
+    // Removes the background task referenced by taskIdentifier, and the task will
+    // not be executed any further. If memory was allocated for the original Task*
+    // used when the task was added, this method will not free that memory. It is
+    // the responsibility of the original creator to clean up memory.
+    int8_t removeBackgroundTask(int8_t taskIdentifier);
     
-    // Removes all tasks that were previously added. No tasks will be executed
-    // after this method is called.
+    // Removes all tasks and background tasks that were previously added. No tasks
+    // will be executed after this method is called.
     void removeAllTasks(void);
   
     // Returns true if the task manager is currently executing, false otherwise.
     bool isExecuting(void);
   
+    // Returns the percent of the last measured window that was spent executing
+    // tasks. Background tasks and tasks with a period of 0 are not included.
+    uint8_t getUtilization(void);
+  
+    // Returns true if the last measured window was overloaded, false otherwise.
+    bool isOverloaded(void);
+  
     // Starts the task manager. All previously added tasks will begin executing
     // at the frequency of the periodInMillis they were added with when the
     // update() method is periodically called.
@@ -94,9 +181,11 @@ class TaskManager {
     // executing.
     void startMonitoringButton(uint8_t buttonPin, uint8_t defaultButtonState);
   
-    // Checks for the next task to be executed and executes it. This method should
-    // be called periodically, typically in the Arduino loop() method. If this
-    // method is not called, then no tasks will be executed.
+    // Checks for the next task to be executed and executes it. Then, if the slack
+    // time before the next task is due fits the cost of the next background task,
+    // that background task is executed. This method should be called periodically,
+    // typically in the Arduino loop() method. If this method is not called, then
+    // no tasks will be executed.
     void update(void);
   
     // Stops the task manager. All added tasks will no longer be executed when
@@ -117,12 +206,44 @@ class TaskManager {
         Task* task;
         uint32_t periodInMillis;
         uint32_t lastExecutionTime;
+        uint32_t minPeriodInMillis;
+        uint32_t maxPeriodInMillis;
+        int8_t reservationIndex;
+    };
+    
+    struct TaskReservation {
+        int8_t taskIdentifier;
+        uint32_t budgetInMicros;
+        uint32_t replenishPeriodInMillis;
+        int32_t remainingBudgetInMicros;
+        uint32_t lastReplenishTime;
+        uint32_t usedInMicros;
+        uint32_t maxUsedInMicros;
+    };
+    
+    struct BackgroundTaskEvent {
+        TaskEvent taskEvent;
+        uint32_t costInMicros;
+        bool isCostMeasured;
     };
 
     TaskEvent _idleTaskEvents[MAX_IDLE_TASKS];
     TaskEvent _taskEvents[MAX_TASKS];
+    BackgroundTaskEvent _backgroundTaskEvents[MAX_BACKGROUND_TASKS];
+    TaskReservation _taskReservations[MAX_RESERVED_TASKS];
     bool _isExecuting;
     uint8_t _nextIndex;   
+    uint8_t _nextBackgroundIndex;
+    uint8_t _backgroundTaskCount;
+    
+    uint32_t _windowStartTime;
+    uint32_t _windowBusyMicros;
+    uint32_t _windowLatenessMillis;
+    uint32_t _windowExecutions;
+    uint8_t _utilizationPercent;
+    bool _isOverloaded;
+    uint8_t _overloadedWindows;
+    uint8_t _underloadedWindows;
     
     BlinkTask _builtinBlinkTask;
     BlinkTask _builtinIdleBlinkTask;
@@ -130,13 +251,27 @@ class TaskManager {
     bool startTask(TaskEvent* taskEvent);
     void startAllTasks();
     void startAllIdleTasks();
+    void startAllBackgroundTasks();
     void stopAllTasks();
     void stopAllIdleTasks();
+    void stopAllBackgroundTasks();
     uint8_t executeNextTask(uint8_t nextTaskIndex, TaskEvent* taskEvents, uint8_t taskEventsSize);
     bool executeTask(TaskEvent* taskEvent);
+    TaskReservation* findTaskReservation(TaskEvent* taskEvent);
+    bool replenishTaskReservation(TaskReservation* taskReservation);
+    void resetLoadWindow(void);
+    void checkLoad(void);
+    void changeElasticTaskPeriods(bool stretch);
+    uint32_t getSlackInMicros(void);
+    void executeNextBackgroundTask(void);
+    bool executeBackgroundTask(BackgroundTaskEvent* backgroundTaskEvent, uint32_t slackInMicros);
     int8_t findFreeSlot(void);
     int8_t findFreeIdleSlot(void);
+    int8_t findFreeBackgroundSlot(void);
+    int8_t findFreeReservationSlot(void);
     void emptyTaskEvent(TaskEvent* taskEvent);
+    void emptyBackgroundTaskEvent(BackgroundTaskEvent* backgroundTaskEvent);
+    void emptyTaskReservation(TaskReservation* taskReservation);
 };
 
 // This is the global instance of the task manager that
@@ -0,0 +1,41 @@
+//
+// Licensed under Apache 2.0 license.
+// See accompanying LICENSE file for details.
+//
+
+#ifndef TASKMANAGERTASK_H
+#define TASKMANAGERTASK_H
+
+#include "Task.h"
+#include "TaskManager.h"
+
+// This is a task that runs another task manager, so that one task
+// manager can be added to another one. The tasks of the wrapped task
+// manager are started, updated, and stopped along with the task
+// manager this task is added to. Adding this task with
+// addReservedTask() limits the time those tasks can take.
+//
+// The wrapped task manager should not also be started or updated
+// directly, since this task does that.
+//
+class TaskManagerTask : public Task {
+  public:
+    TaskManagerTask(TaskManager& taskManager) : _taskManager(taskManager) {};
+
+    void start(void) {
+      _taskManager.start();
+    };
+
+    void update(void) {
+      _taskManager.update();
+    };
+
+    void stop(void) {
+      _taskManager.stop();
+    };
+
+  private:
+    TaskManager& _taskManager;
+};
+
+#endif // TASKMANAGERTASK_H